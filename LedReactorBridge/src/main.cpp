@@ -29,6 +29,8 @@
 #include "Private.h"
 #include <WiFiClient.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <map>
 // #include <ESPAsyncUDP.h>
 // #include <ESP8266SSDP.h>
 
@@ -46,12 +48,29 @@
 #define MESH_SUBGROUP   "0x0000"
 #define MESH_PORT       20002
 
+// Upper bound on nodes with individually tracked state
+#define MAX_TRACKED_NODES   32
+
 // Prototypes
 void setMqtt(int mqttPort=1883);
 void receiveMqtt(char*, uint8_t*, unsigned int);
 void receiveMesh(const uint32_t&, const String&);
 void sendMulticast();
 
+// Latest intended state for the subgroup or a single node
+struct TrackedState {
+    std::array<uint16_t, 4> rgbw = {0, 0, 0, 0};
+    // False once a recall makes the colour depend on the node's saved value
+    bool hasColor = false;
+    // Serialized endless loop with relative start; empty once cleared or
+    // replaced by a one-shot
+    std::string fx;
+    // Version at which each field last changed; 0 if never set
+    uint32_t colorVersion = 0, fxVersion = 0;
+    // Version of the most recently stored loop; 0 if none was ever stored
+    uint32_t loopVersion = 0;
+};
+
 // Global variables
 IPAddress* multicastIp;
 IPAddress ip(0, 0, 0, 0);
@@ -63,6 +82,11 @@ PubSubClient* mqttClient;
 std::string hostname("reactorBridge");
 std::string fromTopic("reactor/from/");
 
+// Versioned state, so rejoining nodes can request only what they missed
+uint32_t stateEpoch = 0, stateVersion = 0;
+TrackedState groupState;
+std::map<uint32_t, TrackedState> nodeStates;
+
 // Scheduler scheduler;
 // AsyncUDP udp;
 // WiFiServer server(20004);
@@ -93,6 +117,9 @@ void initialize() {
     mesh.setHostname(hostname.c_str());
     mesh.setRoot(true);
     mesh.setContainsRoot(true);
+    // Epoch changes every boot, invalidating versions held by nodes
+    stateEpoch = ESP.random();
+    stateEpoch = stateEpoch ? stateEpoch : 1;
 }
 
 
@@ -124,6 +151,178 @@ void copyValues(
 }
 
 
+uint32_t absoluteStart(double start, double duration) {
+    // Converts relative start in seconds to absolute mesh time
+    uint64_t absolute = (mesh.getNodeTime() + (static_cast<uint32_t>(start * 1000000)));
+    // Check if end occurs after clock rollover
+    uint32_t end = (absolute + (static_cast<uint32_t>(duration * 1000000)));
+    if (end > (4294967295 - deferenceBuffer)) {
+        absolute = 1;
+    }
+    return static_cast<uint32_t>(absolute);
+}
+
+
+bool meshContains(uint32_t nodeId) {
+    std::list<uint32_t> nodeList = mesh.getNodeList();
+    return std::find(nodeList.begin(), nodeList.end(), nodeId) != nodeList.end();
+}
+
+
+bool parseRecipient(const std::string& targetRecipient, uint32_t& recipient) {
+    // Accepts only a complete, nonzero numeric node id
+    char* end = nullptr;
+    recipient = strtoul(targetRecipient.c_str(), &end, 10);
+    if (targetRecipient.empty() || (*end != '\0') || !recipient) {
+        recipient = 0;
+        return false;
+    }
+    return true;
+}
+
+
+TrackedState* trackedNode(uint32_t nodeId) {
+    // Returns tracked state for a node, evicting the stalest entry when full
+    auto node = nodeStates.find(nodeId);
+    if (node != nodeStates.end()) {
+        return &node->second;
+    }
+    if (nodeStates.size() >= MAX_TRACKED_NODES) {
+        auto stalest = std::min_element(
+                nodeStates.begin(), nodeStates.end(),
+                [](const std::pair<const uint32_t, TrackedState>& a,
+                        const std::pair<const uint32_t, TrackedState>& b) {
+                    return std::max(a.second.colorVersion, a.second.fxVersion)
+                        < std::max(b.second.colorVersion, b.second.fxVersion);
+                }
+            );
+        Serial.printf("Evicting tracked state for %u\n", stalest->first);
+        nodeStates.erase(stalest);
+    }
+    return &nodeStates[nodeId];
+}
+
+
+bool recordState(
+        StaticJsonDocument<jsonBufferCapacity>& outgoing,
+        TrackedState& state,
+        double fxStart
+    ) {
+    // Records outgoing state changes; returns whether anything changed
+    uint32_t version = stateVersion + 1;
+    bool changed(false);
+    if (outgoing["clear"]) {
+        state.fx.clear();
+        state.fxVersion = version;
+        changed = true;
+    }
+    if (outgoing["recall"]) {
+        // Recalled colour is only known to the node itself
+        state.hasColor = false;
+        state.colorVersion = version;
+        changed = true;
+    }
+    // Effects with recall set return to the saved colour, not their target
+    bool recallEffect = (outgoing["fx"] != (char*)NULL) && outgoing["fx"][1].as<bool>();
+    if ((outgoing["rgbw"] != (char*)NULL) && !recallEffect) {
+        JsonArray color = outgoing["rgbw"];
+        state.rgbw = {color[0], color[1], color[2], color[3]};
+        state.hasColor = true;
+        state.colorVersion = version;
+        changed = true;
+    }
+    if (outgoing["fx"] != (char*)NULL) {
+        JsonArray effect = outgoing["fx"];
+        int32_t loop = effect[10];
+        state.fx.clear();
+        // Only endless loops outlast the cue that created them
+        if (loop == -1) {
+            // Store relative start, restoring the absolute start to be sent
+            uint32_t scheduled = effect[2];
+            effect[2] = fxStart;
+            serializeJson(effect, state.fx);
+            effect[2] = scheduled;
+            state.loopVersion = version;
+        }
+        state.fxVersion = version;
+        changed = true;
+    }
+    if (changed) {
+        stateVersion = version;
+    }
+    return changed;
+}
+
+
+void stampVersion(JsonDocument& outgoing) {
+    JsonArray version = outgoing.createNestedArray("v");
+    version.add(stateEpoch);
+    version.add(stateVersion);
+}
+
+
+bool sendStateDelta(const uint32_t& sender, const String& message) {
+    // Answers sync requests with state changed since the node's last version
+    if (message.indexOf("\"sync\"") < 0) {
+        return false;
+    }
+    uint32_t since(0);
+    {
+        StaticJsonDocument<128> request;
+        if (deserializeJson(request, message.c_str()) || !request["sync"].is<JsonArray>()) {
+            return false;
+        }
+        JsonArray known = request["sync"];
+        since = (known[0].as<uint32_t>() == stateEpoch) ? known[1].as<uint32_t>() : 0;
+    }
+    // Node-specific state overrides group state when it is newer
+    const TrackedState* color = &groupState;
+    const TrackedState* effect = &groupState;
+    uint32_t loopVersion = groupState.loopVersion;
+    auto node = nodeStates.find(sender);
+    if (node != nodeStates.end()) {
+        if (node->second.colorVersion > color->colorVersion) {
+            color = &node->second;
+        }
+        if (node->second.fxVersion > effect->fxVersion) {
+            effect = &node->second;
+        }
+        loopVersion = std::max(loopVersion, node->second.loopVersion);
+    }
+    // Holds sync, v, rgbw and one fx array at most
+    StaticJsonDocument<512> delta;
+    if ((effect->fxVersion > since) && !effect->fx.empty()) {
+        // Parse the stored loop straight into the reply
+        std::string frame("{\"fx\":");
+        frame += effect->fx + "}";
+        deserializeJson(delta, frame);
+        JsonArray replay = delta["fx"];
+        /* Restart the loop relative to current mesh time; its period depends
+        on how the node's LedWriter expands the effect, so the original phase
+        cannot be advanced here, and a stale absolute start may have wrapped */
+        replay[2] = absoluteStart(replay[2].as<double>(), replay[0].as<double>());
+    } else if ((effect->fxVersion > since) && since && loopVersion) {
+        // Only nodes that may be running a since-replaced loop need clearing
+        delta["clear"] = true;
+    }
+    // Marks the frame as a sync reply, which alone may complete a node's sync
+    delta["sync"] = true;
+    stampVersion(delta);
+    if ((color->colorVersion > since) && color->hasColor) {
+        JsonArray rgbw = delta.createNestedArray("rgbw");
+        for (auto level: color->rgbw) {
+            rgbw.add(level);
+        }
+    }
+    String serializedDelta;
+    serializeJson(delta, serializedDelta);
+    uint32_t destination = sender;
+    mesh.sendSingle(destination, serializedDelta);
+    Serial.printf("Sent state delta since %u to %u: %s\n", since, sender, serializedDelta.c_str());
+    return true;
+}
+
+
 void parseMessage(const char* json, std::string targetRecipient) {
     StaticJsonDocument<jsonBufferCapacity> parser;
     std::vector<const char*> keys = {
@@ -134,6 +333,7 @@ void parseMessage(const char* json, std::string targetRecipient) {
     if (!error) {
         StaticJsonDocument<jsonBufferCapacity> outgoing;
         char serialized[512];
+        double fxStart(0);
         if (parser["test"]) {
             publish("Remote bridge node test successful");
         }
@@ -149,17 +349,11 @@ void parseMessage(const char* json, std::string targetRecipient) {
         if (parser.containsKey("fx")) {
             JsonArray effect = parser["fx"];
             // Extract relative start time in seconds
-            double start = effect[2];
+            fxStart = effect[2];
             // Extract duration in seconds
             double duration = effect[0];
-            uint64_t absoluteStart = (mesh.getNodeTime() + (static_cast<uint32_t>(start * 1000000)));
-            // Check if end occurs after clock rollover
-            uint32_t end = (absoluteStart + (static_cast<uint32_t>(duration * 1000000)));
-            if (end > (4294967295 - deferenceBuffer)) {
-                absoluteStart = 1;
-            }
             // Swap relative effect start for absolute start time, relative to current mesh time
-            effect[2] = static_cast<uint32_t>(absoluteStart);
+            effect[2] = absoluteStart(fxStart, duration);
             // Copy effect settings to output buffer
             outgoing["fx"] = effect;
         }
@@ -180,12 +374,30 @@ void parseMessage(const char* json, std::string targetRecipient) {
                 empty = false;
             }
         }
+        bool broadcast = (targetRecipient == "broadcast");
+        uint32_t recipient(0);
+        if (!broadcast && !parseRecipient(targetRecipient, recipient)) {
+            Serial.println("Invalid recipient");
+        }
+        if (!empty && (broadcast || recipient)) {
+            TrackedState* state = broadcast ? &groupState : trackedNode(recipient);
+            if ((state != nullptr) && recordState(outgoing, *state, fxStart)) {
+                stampVersion(outgoing);
+            }
+        }
         serializeJson(outgoing, serialized);
         Serial.printf("Serialized: %s\n", serialized);
         // Broadcast to mesh
-        if (!empty && (targetRecipient == "broadcast")) {
+        if (!empty && broadcast) {
             mesh.sendBroadcast(serialized);
             Serial.println("Broadcast message sent");
+        } else if (!empty && recipient && meshContains(recipient)) {
+            String single(serialized);
+            mesh.sendSingle(recipient, single);
+            Serial.printf("Message sent to %u\n", recipient);
+        } else if (!empty && recipient) {
+            // Tracked state reaches the node when it rejoins and syncs
+            Serial.printf("Node %u not in mesh; state recorded\n", recipient);
         }
         Serial.println("Message parsed successfully\n");
     } else {
@@ -201,6 +413,7 @@ void receiveMqtt(char* topic, uint8_t* payload, unsigned int length) {
     interpreted[length] = '\0';
     std::string incomingTopic(topic);
     std::string group = incomingTopic.substr(11, 6);
+    // "broadcast" for the whole subgroup, or a numeric node id sent singly
     std::string targetRecipient = incomingTopic.substr(18);
     Serial.printf("Subgroup: %s\tTarget: %s\t", group.c_str(), targetRecipient.c_str());
     if (group == MESH_SUBGROUP) {
@@ -214,6 +427,9 @@ void receiveMqtt(char* topic, uint8_t* payload, unsigned int length) {
 
 void receiveMesh(const uint32_t& sender, const String& message) {
     Serial.printf("Received from %u: %s\n", sender, message.c_str());
+    if (sendStateDelta(sender, message)) {
+        return;
+    }
     String outgoingTopic("reactor/from/");
     outgoingTopic += static_cast<String>(sender);
     mqttClient->publish(outgoingTopic.c_str(), message.c_str());
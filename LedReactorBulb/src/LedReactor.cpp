@@ -5,8 +5,16 @@ LedWriter<4>* LedReactor::writer = nullptr;
 bool
     LedReactor::verbose = false,
     LedReactor::connected = false,
-    LedReactor::reset = false;
-uint32_t LedReactor::statusIndex = 0;
+    LedReactor::reset = false,
+    LedReactor::bridgeConnected = false,
+    LedReactor::synced = false;
+uint32_t
+    LedReactor::statusIndex = 0,
+    LedReactor::bridgeId = 0,
+    LedReactor::stateEpoch = 0,
+    LedReactor::stateVersion = 0,
+    LedReactor::lastSyncRequest = 0,
+    LedReactor::syncAttempts = 0;
 
 LedReactor::LedReactor() {}
 
@@ -37,6 +45,39 @@ void LedReactor::monitorMesh() {
     } else if (nodeList.empty() && connected && reset) {
         restart();
     }
+    bool reachable = bridgeReachable(nodeList);
+    if (reachable && !bridgeConnected) {
+        // Rejoined; catch up on anything missed while disconnected
+        bridgeConnected = true;
+        synced = false;
+        syncAttempts = 0;
+        requestSync();
+    } else if (!reachable && bridgeConnected) {
+        bridgeConnected = false;
+        synced = false;
+    }
+}
+
+bool LedReactor::bridgeReachable(const std::list<uint32_t>& nodeList) {
+    // Any neighbour will do until the bridge has identified itself
+    if (!bridgeId) {
+        return !nodeList.empty();
+    }
+    return std::find(nodeList.begin(), nodeList.end(), bridgeId) != nodeList.end();
+}
+
+void LedReactor::requestSync() {
+    // Asks the bridge for state changed since the last known version
+    String request("{\"sync\":[");
+    request += String(stateEpoch) + "," + String(stateVersion) + "]}";
+    if (bridgeId) {
+        mesh.sendSingle(bridgeId, request);
+    } else {
+        mesh.sendBroadcast(request);
+    }
+    lastSyncRequest = millis();
+    syncAttempts++;
+    prints("Requested state sync");
 }
 
 void LedReactor::init(
@@ -78,12 +119,31 @@ double LedReactor::selectMode(int mode, double duration) {
     }
 }
 
-void LedReactor::parseMessage(const char* json) {
+void LedReactor::parseMessage(const char* json, uint32_t sender) {
     // Parses messages received by mesh and applies them
     prints("Parsing message...", "");
     StaticJsonDocument<2048> parser;
     auto error = deserializeJson(parser, json);
     if (!error) {
+        if (parser["sync"].is<JsonArray>()) {
+            prints("Ignoring sync request from another node");
+            return;
+        }
+        if (parser.containsKey("v")) {
+            // Versioned state from the bridge
+            bridgeId = sender ? sender : bridgeId;
+            bool reply = parser["sync"];
+            // Live frames may not skip past changes missed before syncing
+            if (reply || synced) {
+                JsonArray version = parser["v"];
+                stateEpoch = version[0];
+                stateVersion = version[1];
+            }
+            if (reply) {
+                synced = true;
+                syncAttempts = 0;
+            }
+        }
         JsonArray color = parser["rgbw"], effect = parser["fx"];
         std::array<uint16_t, 4> target = writer->getCurrent();
         if (parser["rgbw"]) {
@@ -195,7 +255,7 @@ void LedReactor::parseMessage(const char* json) {
 void LedReactor::receiveMesh(const uint32_t& sender, const String& message) {
     // Callback for messages received by mesh network
     prints("Receiving...");
-    parseMessage(message.c_str());
+    parseMessage(message.c_str(), sender);
     prints("Received");
 }
 
@@ -211,6 +271,15 @@ void LedReactor::updateLeds(void* parameter) {
 void LedReactor::run() {
     // Runs necessary processes; required loop for operation.
     mesh.update();
+    if (bridgeConnected && !synced && (bridgeId || (syncAttempts < SYNC_BROADCASTS))) {
+        uint32_t interval = std::min<uint32_t>(
+                SYNC_INTERVAL << std::min<uint32_t>(syncAttempts ? (syncAttempts - 1) : 0, 4),
+                SYNC_INTERVAL_MAX
+            );
+        if ((millis() - lastSyncRequest) > interval) {
+            requestSync();
+        }
+    }
     if (verbose && ++statusIndex % 1000000 == 0) {
         status();
     }
@@ -3,6 +3,7 @@
 
 #include <painlessMesh.h>
 #include <LedWriter.h>
+#include <algorithm>
 
 // Mesh network information
 #define MESH_PREFIX     "reactor"
@@ -13,10 +14,18 @@
 // Prevent LedWriter from running itself
 #define USE_TASKS       false
 
+// Milliseconds before the first state sync retry, doubling up to the maximum
+#define SYNC_INTERVAL       5000
+#define SYNC_INTERVAL_MAX   60000
+
+// Broadcast sync requests sent before the bridge's node id is known
+#define SYNC_BROADCASTS     3
+
 class LedReactor : public SimpleSerialBase {
     public:
-        static bool verbose, connected, reset;
+        static bool verbose, connected, reset, bridgeConnected, synced;
         static uint32_t statusIndex;
+        static uint32_t bridgeId, stateEpoch, stateVersion, lastSyncRequest, syncAttempts;
         static painlessMesh mesh;
         static LedWriter<4>* writer;
         LedReactor();
@@ -33,9 +42,11 @@ class LedReactor : public SimpleSerialBase {
         static void restart();
         static void monitorMesh();
         static void sync(int32_t);
+        static bool bridgeReachable(const std::list<uint32_t>&);
+        static void requestSync();
         static double selectMode(int, double);
         static void hold(double, double timeIndex=1, bool all=false);
-        static void parseMessage(const char*);
+        static void parseMessage(const char*, uint32_t sender=0);
         static void receiveMesh(const uint32_t&, const String&);
         static void startMulticoreTasks();
         static void updateLeds(void*);